@@ -0,0 +1,101 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include "prelude.h"
+
+#include <stdlib.h>
+#include <sys/mman.h>
+
+// NOTE: Every allocation is aligned to at least `ARENA_ALIGN` bytes, which
+// covers both SSE and AVX loads/stores. Blocks are page aligned; a struct
+// placed at the front of one has to mark its SIMD planes
+// `_Alignas(ARENA_ALIGN)` itself to get the same guarantee.
+#define ARENA_ALIGN     32
+#define HUGE_PAGE_BYTES (2 * 1024 * 1024)
+
+typedef struct {
+    u8*   base;
+    usize cap;
+    usize used;
+    usize high_water;
+} Arena;
+
+typedef struct {
+    void* pointer;
+    usize size;
+    Bool  huge;
+} Block;
+
+static usize align_up(usize x, usize align) {
+    return (x + (align - 1)) & ~(align - 1);
+}
+
+static void init_arena(Arena* arena, void* base, usize cap) {
+    arena->base = (u8*)base;
+    arena->cap = cap;
+    arena->used = 0;
+    arena->high_water = 0;
+}
+
+static void* alloc_arena(Arena* arena, usize size) {
+    const usize start = align_up(arena->used, ARENA_ALIGN);
+    if (arena->cap < (start + size)) {
+        ERROR("arena->cap < (start + size)");
+    }
+    arena->used = start + size;
+    if (arena->high_water < arena->used) {
+        arena->high_water = arena->used;
+    }
+    return &arena->base[start];
+}
+
+static void reset_arena(Arena* arena) {
+    arena->used = 0;
+}
+
+// NOTE: Hands back the high-water mark so far and restarts it from `used`,
+// so a one-off setup phase can be reported apart from the steady state.
+static usize take_high_water(Arena* arena) {
+    const usize high_water = arena->high_water;
+    arena->high_water = arena->used;
+    return high_water;
+}
+
+// NOTE: Ask for explicit huge pages first; if none are reserved, fall back to
+// regular pages and let transparent huge pages back them where possible.
+// Either way the block comes back zeroed.
+static Block alloc_block(usize size) {
+    Block block = {
+        .pointer = NULL,
+        .size = align_up(size, HUGE_PAGE_BYTES),
+        .huge = TRUE,
+    };
+    block.pointer = mmap(NULL,
+                         block.size,
+                         PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                         -1,
+                         0);
+    if (block.pointer == MAP_FAILED) {
+        block.huge = FALSE;
+        block.pointer = mmap(NULL,
+                             block.size,
+                             PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS,
+                             -1,
+                             0);
+        if (block.pointer == MAP_FAILED) {
+            ERROR("block.pointer == MAP_FAILED");
+        }
+        madvise(block.pointer, block.size, MADV_HUGEPAGE);
+    }
+    return block;
+}
+
+static void free_block(Block block) {
+    if (munmap(block.pointer, block.size)) {
+        ERROR("munmap(...)");
+    }
+}
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef __CAPTURE_H__
+#define __CAPTURE_H__
+
+#include "color.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// NOTE: Frames are copied into a fixed ring of slots and written out by a
+// separate thread, so the render loop only ever waits on disk when the ring
+// is full (counted in `stalls`).
+#define CAPTURE_QUEUE_CAP 8
+#define CAPTURE_PATH_CAP  256
+
+typedef enum {
+    CAPTURE_PPM = 0,
+    CAPTURE_RAW,
+} CaptureFormat;
+
+typedef struct {
+    Pixel           frames[CAPTURE_QUEUE_CAP][VIEW_HEIGHT][VIEW_WIDTH];
+    u32             index[CAPTURE_QUEUE_CAP];
+    pthread_t       thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t  not_empty;
+    pthread_cond_t  not_full;
+    const char*     path;
+    FILE*           stream;
+    u32             head;
+    u32             tail;
+    u32             stalls;
+    CaptureFormat   format;
+    Bool            done;
+} Capture;
+
+static void write_ppm(const char* directory,
+                      u32         index,
+                      Pixel       frame[VIEW_HEIGHT][VIEW_WIDTH]) {
+    char path[CAPTURE_PATH_CAP];
+    if (CAPTURE_PATH_CAP <=
+        snprintf(path, CAPTURE_PATH_CAP, "%s/%06u.ppm", directory, index))
+    {
+        ERROR("CAPTURE_PATH_CAP <= snprintf(...)");
+    }
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        ERROR("!file");
+    }
+    fprintf(file, "P6\n%d %d\n255\n", VIEW_WIDTH, VIEW_HEIGHT);
+    u8 row[VIEW_WIDTH * 3];
+    for (u8 i = 0; i < VIEW_HEIGHT; ++i) {
+        for (u8 j = 0; j < VIEW_WIDTH; ++j) {
+            row[(j * 3) + 0] = frame[i][j].rgb.red;
+            row[(j * 3) + 1] = frame[i][j].rgb.green;
+            row[(j * 3) + 2] = frame[i][j].rgb.blue;
+        }
+        if (fwrite(row, sizeof(row), 1, file) != 1) {
+            ERROR("fwrite(...) != 1");
+        }
+    }
+    fclose(file);
+}
+
+static void* capture_thread(void* argument) {
+    Capture* capture = (Capture*)argument;
+    for (;;) {
+        pthread_mutex_lock(&capture->mutex);
+        while ((capture->head == capture->tail) && (!capture->done)) {
+            pthread_cond_wait(&capture->not_empty, &capture->mutex);
+        }
+        if (capture->head == capture->tail) {
+            pthread_mutex_unlock(&capture->mutex);
+            return NULL;
+        }
+        const u32 slot = capture->tail % CAPTURE_QUEUE_CAP;
+        pthread_mutex_unlock(&capture->mutex);
+        // NOTE: The slot stays reserved until `tail` moves past it, so it is
+        // safe to write it out without holding the lock.
+        switch (capture->format) {
+        case CAPTURE_PPM: {
+            write_ppm(capture->path,
+                      capture->index[slot],
+                      capture->frames[slot]);
+            break;
+        }
+        case CAPTURE_RAW: {
+            if (fwrite(capture->frames[slot],
+                       sizeof(capture->frames[slot]),
+                       1,
+                       capture->stream) != 1)
+            {
+                ERROR("fwrite(...) != 1");
+            }
+            break;
+        }
+        }
+        pthread_mutex_lock(&capture->mutex);
+        ++capture->tail;
+        pthread_cond_signal(&capture->not_full);
+        pthread_mutex_unlock(&capture->mutex);
+    }
+}
+
+static void capture_start(Capture*      capture,
+                          CaptureFormat format,
+                          const char*   path) {
+    capture->format = format;
+    capture->path = path;
+    capture->head = 0;
+    capture->tail = 0;
+    capture->stalls = 0;
+    capture->done = FALSE;
+    capture->stream = NULL;
+    if (format == CAPTURE_RAW) {
+        capture->stream = fopen(path, "wb");
+        if (!capture->stream) {
+            ERROR("!capture->stream");
+        }
+    }
+    if (pthread_mutex_init(&capture->mutex, NULL) ||
+        pthread_cond_init(&capture->not_empty, NULL) ||
+        pthread_cond_init(&capture->not_full, NULL))
+    {
+        ERROR("pthread_*_init(...)");
+    }
+    if (pthread_create(&capture->thread, NULL, capture_thread, capture)) {
+        ERROR("pthread_create(...)");
+    }
+}
+
+static void capture_push(Capture* capture,
+                         Pixel    buffer[VIEW_HEIGHT][VIEW_WIDTH],
+                         u32      index) {
+    pthread_mutex_lock(&capture->mutex);
+    if ((capture->head - capture->tail) == CAPTURE_QUEUE_CAP) {
+        ++capture->stalls;
+        do {
+            pthread_cond_wait(&capture->not_full, &capture->mutex);
+        } while ((capture->head - capture->tail) == CAPTURE_QUEUE_CAP);
+    }
+    const u32 slot = capture->head % CAPTURE_QUEUE_CAP;
+    memcpy(capture->frames[slot], buffer, sizeof(capture->frames[slot]));
+    capture->index[slot] = index;
+    ++capture->head;
+    pthread_cond_signal(&capture->not_empty);
+    pthread_mutex_unlock(&capture->mutex);
+}
+
+static void capture_stop(Capture* capture) {
+    pthread_mutex_lock(&capture->mutex);
+    capture->done = TRUE;
+    pthread_cond_signal(&capture->not_empty);
+    pthread_mutex_unlock(&capture->mutex);
+    if (pthread_join(capture->thread, NULL)) {
+        ERROR("pthread_join(...)");
+    }
+    if (capture->stream) {
+        fclose(capture->stream);
+        capture->stream = NULL;
+    }
+    pthread_cond_destroy(&capture->not_full);
+    pthread_cond_destroy(&capture->not_empty);
+    pthread_mutex_destroy(&capture->mutex);
+}
+
+#endif
@@ -27,4 +27,33 @@ static const Pixel COLOR_LIGHT = {
     .rgb = {.red = 60, .green = 40, .blue = 45},
 };
 
+// NOTE: Light intensities are quantised down to `LIGHT_LEVELS` steps
+// (`intensity >> LIGHT_SHIFT`) so that compositing a cell is a single table
+// lookup, indexed by whether or not the cell is a wall.
+#define LIGHT_LEVELS 16
+#define LIGHT_SHIFT  4
+
+static Pixel LIGHT_LUT[2][LIGHT_LEVELS];
+
+static u8 get_light_channel(u8 base, u8 light, u8 level) {
+    return (u8)(base + ((light * level) / (LIGHT_LEVELS - 1)));
+}
+
+static void init_light_lut(void) {
+    const Pixel bases[2] = {COLOR_EMPTY, COLOR_WALL};
+    for (u8 i = 0; i < 2; ++i) {
+        const Rgb base = bases[i].rgb;
+        for (u8 j = 0; j < LIGHT_LEVELS; ++j) {
+            Pixel* pixel = &LIGHT_LUT[i][j];
+            pixel->pack = 0;
+            pixel->rgb.red =
+                get_light_channel(base.red, COLOR_LIGHT.rgb.red, j);
+            pixel->rgb.green =
+                get_light_channel(base.green, COLOR_LIGHT.rgb.green, j);
+            pixel->rgb.blue =
+                get_light_channel(base.blue, COLOR_LIGHT.rgb.blue, j);
+        }
+    }
+}
+
 #endif
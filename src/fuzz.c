@@ -0,0 +1,399 @@
+#include "arena.h"
+#include "geom.h"
+#include "pvs.h"
+#include "sight.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// NOTE: Random wall maps and sources; every optimised path (soft lighting,
+// PVS lookups, batched sight queries) has to agree with `set_mask` exactly,
+// and mirrored maps have to give mirrored masks. The first map is the game's
+// own. Any mismatch is fatal. Build with `SANITIZE=1 ./main fuzz <maps>` to
+// run it under ASan/UBSan.
+#define FUZZ_SEED          0x2545F491u
+#define FUZZ_SOURCES       16
+#define FUZZ_SIGHT_QUERIES 256
+#define FUZZ_WALL_PERCENT  50
+#define FUZZ_RADIUS_CAP    32
+#define FUZZ_PVS_CAP       (1 << 19)
+#define FUZZ_SCRATCH_CAP   (1 << 20)
+#define FUZZ_PATH          "/tmp/pxls-fuzz-XXXXXX"
+
+typedef struct {
+    u8 (*mask)[PX_WIDTH];
+    u8 (*reference)[PX_WIDTH];
+    u8 (*flipped)[PX_WIDTH];
+    u8 (*light)[PX_WIDTH];
+    SightQuery* queries;
+    Bool*       results;
+    Pvs*        pvs;
+    Pvs*        loaded;
+    Arena       tables;
+    Arena       files;
+    SightPool   pool;
+    const char* path;
+    u32         casts;
+    u32         pairs;
+    u32         asymmetric;
+} Fuzz;
+
+typedef enum {
+    FLIP_X = 0,
+    FLIP_Y,
+    FLIP_TRANSPOSE,
+    FLIP_COUNT,
+} Flip;
+
+static void get_flip_xy(Flip flip, i16 x, i16 y, i16* flip_x, i16* flip_y) {
+    switch (flip) {
+    case FLIP_X: {
+        *flip_x = (i16)(PX_WIDTH - 1 - x);
+        *flip_y = y;
+        break;
+    }
+    case FLIP_Y: {
+        *flip_x = x;
+        *flip_y = (i16)(PX_HEIGHT - 1 - y);
+        break;
+    }
+    case FLIP_TRANSPOSE: {
+        *flip_x = y;
+        *flip_y = x;
+        break;
+    }
+    case FLIP_COUNT: {
+        ERROR("flip == FLIP_COUNT");
+    }
+    }
+}
+
+static Bool get_lit(u8 mask[PX_HEIGHT][PX_WIDTH], i16 x, i16 y) {
+    return mask[y][x] & MASK_PLAYER ? TRUE : FALSE;
+}
+
+static Bool get_same_lit(u8 a[PX_HEIGHT][PX_WIDTH],
+                         u8 b[PX_HEIGHT][PX_WIDTH]) {
+    for (u8 i = 0; i < PX_HEIGHT; ++i) {
+        for (u8 j = 0; j < PX_WIDTH; ++j) {
+            if ((a[i][j] & MASK_PLAYER) != (b[i][j] & MASK_PLAYER)) {
+                return FALSE;
+            }
+        }
+    }
+    return TRUE;
+}
+
+// NOTE: Casting on a mirrored (or transposed) map from the mirrored source
+// has to light exactly the mirrored cells, since each octant is cast with the
+// same slopes whichever way it faces.
+static void check_flip(Fuzz* fuzz, Flip flip, i16 x, i16 y, i16 radius) {
+    if ((flip == FLIP_TRANSPOSE) && (PX_WIDTH != PX_HEIGHT)) {
+        return;
+    }
+    i16 flip_x;
+    i16 flip_y;
+    for (i16 i = 0; i < PX_HEIGHT; ++i) {
+        for (i16 j = 0; j < PX_WIDTH; ++j) {
+            get_flip_xy(flip, j, i, &flip_x, &flip_y);
+            fuzz->flipped[flip_y][flip_x] =
+                (u8)(fuzz->reference[i][j] & MASK_WALL);
+        }
+    }
+    get_flip_xy(flip, x, y, &flip_x, &flip_y);
+    set_mask(fuzz->flipped, NULL, flip_x, flip_y, radius);
+    ++fuzz->casts;
+    for (i16 i = 0; i < PX_HEIGHT; ++i) {
+        for (i16 j = 0; j < PX_WIDTH; ++j) {
+            get_flip_xy(flip, j, i, &flip_x, &flip_y);
+            if (get_lit(fuzz->reference, j, i) !=
+                get_lit(fuzz->flipped, flip_x, flip_y))
+            {
+                ERROR("get_lit(reference) != get_lit(flipped)");
+            }
+        }
+    }
+}
+
+// NOTE: The shadowcaster is meant to be symmetric: if `(x, y)` lights an
+// open cell, a cast from that cell should light `(x, y)` back. This is
+// counted rather than enforced.
+static void check_symmetry(Fuzz*  fuzz,
+                           Arena* scratch,
+                           i16    x,
+                           i16    y,
+                           i16    radius) {
+    u32 count = 0;
+    for (u8 i = 0; i < PX_HEIGHT; ++i) {
+        for (u8 j = 0; j < PX_WIDTH; ++j) {
+            if ((fuzz->reference[i][j] & MASK_PLAYER) &&
+                (!(fuzz->reference[i][j] & MASK_WALL)))
+            {
+                fuzz->queries[count++] = (SightQuery){
+                    .source_x = j,
+                    .source_y = i,
+                    .target_x = (u8)x,
+                    .target_y = (u8)y,
+                };
+            }
+        }
+    }
+    reset_arena(scratch);
+    query_sight(&fuzz->pool,
+                fuzz->mask,
+                fuzz->queries,
+                count,
+                radius,
+                fuzz->results,
+                scratch);
+    for (u32 i = 0; i < count; ++i) {
+        if (!fuzz->results[i]) {
+            ++fuzz->asymmetric;
+        }
+    }
+    fuzz->pairs += count;
+}
+
+// NOTE: A cast cut off at random bounds, and a PVS lookup limited to them,
+// have to match the full cast inside them, and a light whose radius misses
+// the bounds must not reach them.
+static void check_bounds(Fuzz* fuzz, u32* state, i16 x, i16 y, i16 radius) {
+    Bounds bounds;
+    bounds.x0 = (i16)(get_random(state) % PX_WIDTH);
+    bounds.y0 = (i16)(get_random(state) % PX_HEIGHT);
+    bounds.x1 = (i16)(bounds.x0 + 1 +
+                      (i16)(get_random(state) % (u32)(PX_WIDTH - bounds.x0)));
+    bounds.y1 = (i16)(bounds.y0 + 1 +
+                      (i16)(get_random(state) % (u32)(PX_HEIGHT - bounds.y0)));
+    set_mask_bounds(fuzz->mask, NULL, x, y, radius, &bounds);
+    ++fuzz->casts;
+    const Bool intersect = get_bounds_intersect(&bounds, x, y, radius);
+    for (i16 i = bounds.y0; i < bounds.y1; ++i) {
+        for (i16 j = bounds.x0; j < bounds.x1; ++j) {
+            if (get_lit(fuzz->mask, j, i) != get_lit(fuzz->reference, j, i)) {
+                ERROR("get_lit(bounded) != get_lit(reference)");
+            }
+            if ((!intersect) && get_lit(fuzz->reference, j, i)) {
+                ERROR("!intersect && get_lit(reference)");
+            }
+        }
+    }
+    set_mask_pvs(fuzz->mask, fuzz->pvs, x, y, &bounds);
+    ++fuzz->casts;
+    for (i16 i = bounds.y0; i < bounds.y1; ++i) {
+        for (i16 j = bounds.x0; j < bounds.x1; ++j) {
+            if (get_lit(fuzz->mask, j, i) != get_lit(fuzz->reference, j, i)) {
+                ERROR("get_lit(pvs bounded) != get_lit(reference)");
+            }
+        }
+    }
+}
+
+static void check_source(Fuzz*  fuzz,
+                         Arena* scratch,
+                         u32*   state,
+                         i16    x,
+                         i16    y,
+                         i16    radius) {
+    set_mask(fuzz->mask, NULL, x, y, radius);
+    memcpy(fuzz->reference, fuzz->mask, sizeof(u8[PX_HEIGHT][PX_WIDTH]));
+    set_mask(fuzz->mask, fuzz->light, x, y, radius);
+    if (!get_same_lit(fuzz->mask, fuzz->reference)) {
+        ERROR("!get_same_lit(soft, reference)");
+    }
+    for (i16 i = 0; i < PX_HEIGHT; ++i) {
+        for (i16 j = 0; j < PX_WIDTH; ++j) {
+            if (fuzz->light[i][j] && (!get_lit(fuzz->reference, j, i)) &&
+                ((i != y) || (j != x)))
+            {
+                ERROR("fuzz->light[i][j] && !get_lit(reference)");
+            }
+        }
+    }
+    set_mask_pvs(fuzz->mask, fuzz->pvs, x, y, &BOUNDS_WORLD);
+    if (!get_same_lit(fuzz->mask, fuzz->reference)) {
+        ERROR("!get_same_lit(pvs, reference)");
+    }
+    fuzz->casts += 2;
+    check_bounds(fuzz, state, x, y, radius);
+    for (u8 i = 0; i < FLIP_COUNT; ++i) {
+        check_flip(fuzz, (Flip)i, x, y, radius);
+    }
+    check_symmetry(fuzz, scratch, x, y, radius);
+}
+
+static void corrupt_pvs_file(const char* path, long offset, u32 value) {
+    FILE* file = fopen(path, "r+b");
+    if (!file) {
+        ERROR("!file");
+    }
+    if (fseek(file, offset, SEEK_SET) ||
+        (fwrite(&value, sizeof(u32), 1, file) != 1))
+    {
+        ERROR("fwrite(...)");
+    }
+    fclose(file);
+}
+
+// NOTE: A saved PVS has to load back as-is, while a truncated file or one
+// whose offsets run past its runs has to be turned down without touching the
+// arena.
+static void check_pvs_file(Fuzz* fuzz, i16 radius) {
+    const usize size = sizeof(PvsHeader) + sizeof(u32[PVS_CELLS + 1]) +
+                       (sizeof(u16) * fuzz->pvs->run_count);
+    save_pvs(fuzz->pvs, fuzz->mask, fuzz->path);
+    reset_arena(&fuzz->files);
+    if (!load_pvs(fuzz->loaded, &fuzz->files, fuzz->mask, radius, fuzz->path))
+    {
+        ERROR("!load_pvs(...)");
+    }
+    if (memcmp(fuzz->loaded->offsets,
+               fuzz->pvs->offsets,
+               sizeof(u32[PVS_CELLS + 1])) ||
+        memcmp(fuzz->loaded->runs,
+               fuzz->pvs->runs,
+               sizeof(u16) * fuzz->pvs->run_count))
+    {
+        ERROR("memcmp(loaded, pvs)");
+    }
+    reset_arena(&fuzz->files);
+    if (truncate(fuzz->path, (off_t)(size - sizeof(u16))) ||
+        load_pvs(fuzz->loaded, &fuzz->files, fuzz->mask, radius, fuzz->path))
+    {
+        ERROR("load_pvs(truncated)");
+    }
+    save_pvs(fuzz->pvs, fuzz->mask, fuzz->path);
+    corrupt_pvs_file(fuzz->path,
+                     (long)(sizeof(PvsHeader) + sizeof(u32)),
+                     fuzz->pvs->run_count + 1);
+    if (load_pvs(fuzz->loaded, &fuzz->files, fuzz->mask, radius, fuzz->path)) {
+        ERROR("load_pvs(corrupt)");
+    }
+    if (fuzz->files.used != 0) {
+        ERROR("fuzz->files.used != 0");
+    }
+}
+
+static void check_map(Fuzz* fuzz, Arena* scratch, u32* state, Bool game) {
+    memset(fuzz->mask, 0, sizeof(u8[PX_HEIGHT][PX_WIDTH]));
+    if (game) {
+        init_mask(fuzz->mask);
+    } else {
+        const u32 percent = get_random(state) % FUZZ_WALL_PERCENT;
+        for (u8 i = 0; i < PX_HEIGHT; ++i) {
+            for (u8 j = 0; j < PX_WIDTH; ++j) {
+                fuzz->mask[i][j] =
+                    (get_random(state) % 100) < percent ? MASK_WALL : 0;
+            }
+        }
+    }
+    const i16 radius = (i16)(1 + (get_random(state) % FUZZ_RADIUS_CAP));
+    reset_arena(&fuzz->tables);
+    build_pvs(fuzz->pvs, &fuzz->tables, scratch, fuzz->mask, radius);
+    set_pvs_cache_cap(fuzz->pvs,
+                      (u8)(1 + (get_random(state) % PVS_CACHE_CAP)));
+    check_pvs_file(fuzz, radius);
+    for (u8 i = 0; i < FUZZ_SOURCES; ++i) {
+        u8 x;
+        u8 y;
+        get_open_cell(fuzz->mask, state, &x, &y);
+        check_source(fuzz, scratch, state, x, y, radius);
+    }
+    for (u32 i = 0; i < FUZZ_SIGHT_QUERIES; ++i) {
+        SightQuery* query = &fuzz->queries[i];
+        query->source_x = (u8)(get_random(state) % PX_WIDTH);
+        query->source_y = (u8)(get_random(state) % PX_HEIGHT);
+        query->target_x = (u8)(get_random(state) % PX_WIDTH);
+        query->target_y = (u8)(get_random(state) % PX_HEIGHT);
+    }
+    reset_arena(scratch);
+    query_sight(&fuzz->pool,
+                fuzz->mask,
+                fuzz->queries,
+                FUZZ_SIGHT_QUERIES,
+                radius,
+                fuzz->results,
+                scratch);
+    check_sight(fuzz->mask,
+                fuzz->queries,
+                FUZZ_SIGHT_QUERIES,
+                radius,
+                fuzz->results);
+}
+
+static void fuzz_mask(Arena*      permanent,
+                      Arena*      scratch,
+                      const char* path,
+                      u32         map_count) {
+    Fuzz fuzz = {
+        .mask = alloc_arena(permanent, sizeof(u8[PX_HEIGHT][PX_WIDTH])),
+        .reference = alloc_arena(permanent, sizeof(u8[PX_HEIGHT][PX_WIDTH])),
+        .flipped = alloc_arena(permanent, sizeof(u8[PX_HEIGHT][PX_WIDTH])),
+        .light = alloc_arena(permanent, sizeof(u8[PX_HEIGHT][PX_WIDTH])),
+        .queries = alloc_arena(permanent, sizeof(SightQuery[SIGHT_CELLS])),
+        .results = alloc_arena(permanent, sizeof(Bool[SIGHT_CELLS])),
+        .pvs = alloc_arena(permanent, sizeof(Pvs)),
+        .loaded = alloc_arena(permanent, sizeof(Pvs)),
+        .path = path,
+        .casts = 0,
+        .pairs = 0,
+        .asymmetric = 0,
+    };
+    init_arena(&fuzz.tables,
+               alloc_arena(permanent, FUZZ_PVS_CAP),
+               FUZZ_PVS_CAP);
+    init_arena(&fuzz.files,
+               alloc_arena(permanent, FUZZ_PVS_CAP),
+               FUZZ_PVS_CAP);
+    init_sight_pool(&fuzz.pool);
+    u32 state = FUZZ_SEED;
+    for (u32 i = 0; i < map_count; ++i) {
+        check_map(&fuzz, scratch, &state, i == 0 ? TRUE : FALSE);
+    }
+    free_sight_pool(&fuzz.pool);
+    printf("maps                 :%9u\n"
+           "casts checked        :%9u\n"
+           "sight queries        :%9u\n"
+           "symmetry pairs       :%9u\n"
+           "asymmetric pairs     :%9u\n"
+           "arena.scratch   (kb) :%9.2f\n",
+           map_count,
+           fuzz.casts,
+           map_count * FUZZ_SIGHT_QUERIES,
+           fuzz.pairs,
+           fuzz.asymmetric,
+           (f32)take_high_water(scratch) / 1024.0f);
+}
+
+i32 main(i32 argc, char** argv) {
+    char*               end = NULL;
+    const unsigned long map_count =
+        argc == 2 ? strtoul(argv[1], &end, 10) : 0;
+    if ((!end) || (*end != '\0') || (map_count == 0) ||
+        (UINT32_MAX < map_count))
+    {
+        fprintf(stderr, "usage: %s <maps>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    // NOTE: A symmetry check batches one query per lit cell.
+    if (FUZZ_SCRATCH_CAP < get_sight_scratch_size(SIGHT_CELLS)) {
+        ERROR("FUZZ_SCRATCH_CAP < get_sight_scratch_size(SIGHT_CELLS)");
+    }
+    const usize permanent_cap = (usize)FUZZ_PVS_CAP * 3;
+    const Block block = alloc_block(permanent_cap + FUZZ_SCRATCH_CAP);
+    u8*         base = (u8*)block.pointer;
+    Arena       permanent;
+    Arena       scratch;
+    init_arena(&permanent, base, permanent_cap);
+    init_arena(&scratch, &base[permanent_cap], FUZZ_SCRATCH_CAP);
+    char path[] = FUZZ_PATH;
+    const i32 file = mkstemp(path);
+    if (file < 0) {
+        ERROR("mkstemp(...) < 0");
+    }
+    close(file);
+    fuzz_mask(&permanent, &scratch, path, (u32)map_count);
+    unlink(path);
+    free_block(block);
+    return EXIT_SUCCESS;
+}
@@ -3,8 +3,12 @@
 
 #include "prelude.h"
 
+#include <string.h>
+
 #define SHADOW_APERTURE 0.5f
 
+#define LIGHT_MAX 255.0f
+
 typedef enum {
     MASK_WALL = 1 << 0,
     MASK_PLAYER = 1 << 1,
@@ -172,7 +176,36 @@ static void init_mask(u8 mask[PX_HEIGHT][PX_WIDTH]) {
     }
 }
 
-static void set_mask_col_row(u8 mask[PX_HEIGHT][PX_WIDTH], Octal octal) {
+// NOTE: A cell spans `[l_slope, r_slope]` as seen from the source; the part
+// of that span still inside `[slope_end, slope_start]` is how much of the cell
+// is lit. Blending that with a quadratic falloff gives soft shadow edges.
+static void set_light(u8           light[PX_HEIGHT][PX_WIDTH],
+                      i16          x,
+                      i16          y,
+                      f32          l_slope,
+                      f32          r_slope,
+                      i16          distance_squared,
+                      const Octal* octal) {
+    // NOTE: Clip the cell to the octant first, otherwise cells on the
+    // diagonals and axes would read as half-shadowed from both sides.
+    const f32 l_octant = max_f32(l_slope, 0.0f);
+    const f32 r_octant = min_f32(r_slope, 1.0f);
+    const f32 coverage = clamp_f32((min_f32(r_octant, octal->slope_start) -
+                                    max_f32(l_octant, octal->slope_end)) /
+                                       (r_octant - l_octant),
+                                   0.0f,
+                                   1.0f);
+    const f32 falloff =
+        1.0f - ((f32)distance_squared / (f32)octal->radius_squared);
+    const u8 intensity = (u8)(LIGHT_MAX * coverage * falloff);
+    if (light[y][x] < intensity) {
+        light[y][x] = intensity;
+    }
+}
+
+static void set_mask_col_row(u8    mask[PX_HEIGHT][PX_WIDTH],
+                             u8    light[PX_HEIGHT][PX_WIDTH],
+                             Octal octal) {
     if (octal.slope_start < octal.slope_end) {
         return;
     }
@@ -194,13 +227,21 @@ static void set_mask_col_row(u8 mask[PX_HEIGHT][PX_WIDTH], Octal octal) {
             }
             const i16  x_delta = (i16)(j * octal.x_sign);
             const i16  x = (i16)(octal.x + x_delta);
+            const i16  distance_squared =
+                (i16)((x_delta * x_delta) + y_delta_squared);
             const Bool in_bounds =
                 (0 <= x) && (x < PX_WIDTH) && (0 <= y) && (y < PX_HEIGHT);
-            if (in_bounds &&
-                (((x_delta * x_delta) + y_delta_squared) <
-                 octal.radius_squared))
-            {
+            if (in_bounds && (distance_squared < octal.radius_squared)) {
                 mask[y][x] |= (u8)octal.mask;
+                if (light) {
+                    set_light(light,
+                              x,
+                              y,
+                              l_slope,
+                              r_slope,
+                              distance_squared,
+                              &octal);
+                }
                 visible = TRUE;
             }
             const Bool blocked = (!in_bounds) || (mask[y][x] & MASK_WALL);
@@ -224,7 +265,7 @@ static void set_mask_col_row(u8 mask[PX_HEIGHT][PX_WIDTH], Octal octal) {
                         .y_sign = octal.y_sign,
                         .mask = octal.mask,
                     };
-                    set_mask_col_row(mask, next_octal);
+                    set_mask_col_row(mask, light, next_octal);
                 }
                 prev_blocked = TRUE;
                 next_start = l_slope;
@@ -236,7 +277,9 @@ static void set_mask_col_row(u8 mask[PX_HEIGHT][PX_WIDTH], Octal octal) {
     }
 }
 
-static void set_mask_row_col(u8 mask[PX_HEIGHT][PX_WIDTH], Octal octal) {
+static void set_mask_row_col(u8    mask[PX_HEIGHT][PX_WIDTH],
+                             u8    light[PX_HEIGHT][PX_WIDTH],
+                             Octal octal) {
     if (octal.slope_start < octal.slope_end) {
         return;
     }
@@ -258,13 +301,21 @@ static void set_mask_row_col(u8 mask[PX_HEIGHT][PX_WIDTH], Octal octal) {
             }
             const i16  y_delta = (i16)(i * octal.y_sign);
             const i16  y = (i16)(octal.y + y_delta);
+            const i16  distance_squared =
+                (i16)(x_delta_squared + (y_delta * y_delta));
             const Bool in_bounds =
                 (0 <= x) && (x < PX_WIDTH) && (0 <= y) && (y < PX_HEIGHT);
-            if (in_bounds &&
-                ((x_delta_squared + (y_delta * y_delta)) <
-                 octal.radius_squared))
-            {
+            if (in_bounds && (distance_squared < octal.radius_squared)) {
                 mask[y][x] |= (u8)octal.mask;
+                if (light) {
+                    set_light(light,
+                              x,
+                              y,
+                              l_slope,
+                              r_slope,
+                              distance_squared,
+                              &octal);
+                }
                 visible = TRUE;
             }
             const Bool blocked = (!in_bounds) || (mask[y][x] & MASK_WALL);
@@ -288,7 +339,7 @@ static void set_mask_row_col(u8 mask[PX_HEIGHT][PX_WIDTH], Octal octal) {
                         .y_sign = octal.y_sign,
                         .mask = octal.mask,
                     };
-                    set_mask_row_col(mask, next_octal);
+                    set_mask_row_col(mask, light, next_octal);
                 }
                 prev_blocked = TRUE;
                 next_start = l_slope;
@@ -300,4 +351,159 @@ static void set_mask_row_col(u8 mask[PX_HEIGHT][PX_WIDTH], Octal octal) {
     }
 }
 
+static u8 MASK_RESET[16] = {
+    (u8)~MASK_PLAYER,
+    (u8)~MASK_PLAYER,
+    (u8)~MASK_PLAYER,
+    (u8)~MASK_PLAYER,
+    (u8)~MASK_PLAYER,
+    (u8)~MASK_PLAYER,
+    (u8)~MASK_PLAYER,
+    (u8)~MASK_PLAYER,
+    (u8)~MASK_PLAYER,
+    (u8)~MASK_PLAYER,
+    (u8)~MASK_PLAYER,
+    (u8)~MASK_PLAYER,
+    (u8)~MASK_PLAYER,
+    (u8)~MASK_PLAYER,
+    (u8)~MASK_PLAYER,
+    (u8)~MASK_PLAYER,
+};
+
+static void reset_mask(u8 mask[PX_HEIGHT][PX_WIDTH]) {
+    // NOTE: `PX_WIDTH_BY_HEIGHT` *must* to be divisible by 16.
+    u8* pointer = &mask[0][0];
+    for (u16 i = 0; i < PX_WIDTH_BY_HEIGHT; i = (u16)(i + 16)) {
+        _mm_store_si128((Simd4i32*)&pointer[i],
+                        _mm_and_si128(*(Simd4i32*)&pointer[i],
+                                      *(Simd4i32*)&MASK_RESET[0]));
+    }
+}
+
+static const Bounds BOUNDS_WORLD = {
+    .x0 = 0,
+    .y0 = 0,
+    .x1 = PX_WIDTH,
+    .y1 = PX_HEIGHT,
+};
+
+// NOTE: Only `bounds` is cleared; cells outside it keep whatever the last
+// cast left there, so callers must only read inside `bounds`.
+static void reset_mask_bounds(u8            mask[PX_HEIGHT][PX_WIDTH],
+                              u8            light[PX_HEIGHT][PX_WIDTH],
+                              const Bounds* bounds) {
+    if ((bounds->x0 == 0) && (bounds->y0 == 0) &&
+        (bounds->x1 == PX_WIDTH) && (bounds->y1 == PX_HEIGHT))
+    {
+        reset_mask(mask);
+        if (light) {
+            memset(light, 0, sizeof(u8[PX_HEIGHT][PX_WIDTH]));
+        }
+        return;
+    }
+    const usize width = (usize)(bounds->x1 - bounds->x0);
+    for (i16 i = bounds->y0; i < bounds->y1; ++i) {
+        for (i16 j = bounds->x0; j < bounds->x1; ++j) {
+            mask[i][j] &= (u8)~MASK_PLAYER;
+        }
+        if (light) {
+            memset(&light[i][bounds->x0], 0, width);
+        }
+    }
+}
+
+static Bool get_bounds_intersect(const Bounds* bounds,
+                                 i16           x,
+                                 i16           y,
+                                 i16           radius) {
+    const i16 x_delta =
+        (i16)(x - clamp_i16(x, bounds->x0, (i16)(bounds->x1 - 1)));
+    const i16 y_delta =
+        (i16)(y - clamp_i16(y, bounds->y0, (i16)(bounds->y1 - 1)));
+    return ((x_delta * x_delta) + (y_delta * y_delta)) < (radius * radius)
+               ? TRUE
+               : FALSE;
+}
+
+static void set_mask_quadrant(u8            mask[PX_HEIGHT][PX_WIDTH],
+                              u8            light[PX_HEIGHT][PX_WIDTH],
+                              Octal         octal,
+                              const Bounds* bounds) {
+    const i16 radius = octal.radius;
+    // NOTE: Row `i` only depends on the rows before it, so stopping each
+    // octant at the far edge of `bounds` leaves every cell inside `bounds`
+    // exactly as a full cast would.
+    octal.radius = min_i16(radius,
+                           (i16)(0 < octal.y_sign ? bounds->y1 - 1 - octal.y
+                                                  : octal.y - bounds->y0));
+    set_mask_col_row(mask, light, octal);
+    octal.radius = min_i16(radius,
+                           (i16)(0 < octal.x_sign ? bounds->x1 - 1 - octal.x
+                                                  : octal.x - bounds->x0));
+    set_mask_row_col(mask, light, octal);
+}
+
+// NOTE: Only cells inside `bounds` are guaranteed to match an unbounded cast.
+static void set_mask_bounds(u8            mask[PX_HEIGHT][PX_WIDTH],
+                            u8            light[PX_HEIGHT][PX_WIDTH],
+                            i16           x,
+                            i16           y,
+                            i16           radius,
+                            const Bounds* bounds) {
+    reset_mask_bounds(mask, light, bounds);
+    mask[y][x] &= MASK_PLAYER;
+    if (light) {
+        light[y][x] = (u8)LIGHT_MAX;
+    }
+    Octal octal = {
+        .slope_start = 1.0f,
+        .slope_end = 0.0f,
+        .x = x,
+        .y = y,
+        .loop_start = 1,
+        .radius = radius,
+        .radius_squared = (i16)(radius * radius),
+        .mask = MASK_PLAYER,
+    };
+    {
+        octal.x_sign = 1;
+        octal.y_sign = 1;
+        set_mask_quadrant(mask, light, octal, bounds);
+    }
+    {
+        octal.x_sign = 1;
+        octal.y_sign = -1;
+        set_mask_quadrant(mask, light, octal, bounds);
+    }
+    {
+        octal.x_sign = -1;
+        octal.y_sign = -1;
+        set_mask_quadrant(mask, light, octal, bounds);
+    }
+    {
+        octal.x_sign = -1;
+        octal.y_sign = 1;
+        set_mask_quadrant(mask, light, octal, bounds);
+    }
+}
+
+static void set_mask(u8  mask[PX_HEIGHT][PX_WIDTH],
+                     u8  light[PX_HEIGHT][PX_WIDTH],
+                     i16 x,
+                     i16 y,
+                     i16 radius) {
+    set_mask_bounds(mask, light, x, y, radius, &BOUNDS_WORLD);
+}
+
+// NOTE: `mask` needs at least one open cell.
+static void get_open_cell(u8   mask[PX_HEIGHT][PX_WIDTH],
+                          u32* state,
+                          u8*  x,
+                          u8*  y) {
+    do {
+        *x = (u8)(get_random(state) % PX_WIDTH);
+        *y = (u8)(get_random(state) % PX_HEIGHT);
+    } while (mask[*y][*x] & MASK_WALL);
+}
+
 #endif
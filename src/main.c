@@ -1,8 +1,13 @@
+#include "arena.h"
+#include "capture.h"
 #include "color.h"
 #include "geom.h"
 #include "player.h"
+#include "pvs.h"
+#include "sight.h"
 
 #include <SDL2/SDL.h>
+#include <time.h>
 
 // NOTE: See `https://benedicthenshaw.com/soft_render_sdl2.html`.
 
@@ -15,14 +20,42 @@ typedef struct {
     u8  fps_count;
 } Frame;
 
+typedef enum {
+    LIGHTING_SOFT = 0,
+    LIGHTING_BINARY,
+} Lighting;
+
+// NOTE: `Memory` sits at the front of one contiguous block; the rest of the
+// block is split between the permanent arena (lives as long as the program)
+// and the scratch arena (reset at the top of every frame). Scratch used before
+// the first frame is reported as `scratch_setup`, apart from the frames. The
+// mask and light planes are aligned like arena allocations, so the SIMD paths
+// can rely on `ARENA_ALIGN` wherever a plane comes from.
 typedef struct {
-    Pixel  buffer[PX_HEIGHT][PX_WIDTH];
-    u8     mask[PX_HEIGHT][PX_WIDTH];
-    Player player;
-    Frame  frame;
-    Bool   dead;
+    Pixel    buffer[VIEW_HEIGHT][VIEW_WIDTH];
+    _Alignas(ARENA_ALIGN) u8 mask[PX_HEIGHT][PX_WIDTH];
+    _Alignas(ARENA_ALIGN) u8 light[PX_HEIGHT][PX_WIDTH];
+    Arena    permanent;
+    Arena    scratch;
+    usize    scratch_setup;
+    Block    block;
+    Pvs*     pvs;
+    Player   player;
+    Bounds   camera;
+    Frame    frame;
+    Lighting lighting;
+    Bool     dead;
 } Memory;
 
+// NOTE: `reset_mask` works on the planes 16 bytes at a time, and `buffer`
+// ahead of them changes size with the view.
+_Static_assert(_Alignof(Memory) == ARENA_ALIGN, "Memory");
+_Static_assert((offsetof(Memory, mask) % 16) == 0, "Memory.mask");
+_Static_assert((offsetof(Memory, light) % 16) == 0, "Memory.light");
+
+#define ARENA_PERMANENT_CAP (1 << 20)
+#define ARENA_SCRATCH_CAP   (1 << 20)
+
 #define PLAYER_SHADOW_RADIUS 32
 
 #define FRAME_UPDATE_COUNT   8
@@ -32,7 +65,7 @@ typedef struct {
 
 static const f32 FRAME_DURATION = (1.0f / 60.0f) * MILLISECONDS;
 
-static void set_input(Player* player, Bool* dead) {
+static void set_input(Player* player, Lighting* lighting, Bool* dead) {
     SDL_Event event;
     while (SDL_PollEvent(&event)) {
         switch (event.type) {
@@ -49,6 +82,11 @@ static void set_input(Player* player, Bool* dead) {
                 *dead = TRUE;
                 return;
             }
+            case SDLK_SPACE: {
+                *lighting = *lighting == LIGHTING_SOFT ? LIGHTING_BINARY
+                                                       : LIGHTING_SOFT;
+                break;
+            }
             case SDLK_w:
             case SDLK_i: {
                 player->control[DIR_UP] = ++player->control_counter;
@@ -122,108 +160,60 @@ static void update_frame(u8      mask[PX_HEIGHT][PX_WIDTH],
     frame->prev = frame->start;
 }
 
-static u8 MASK_RESET[16] = {
-    (u8)~MASK_PLAYER,
-    (u8)~MASK_PLAYER,
-    (u8)~MASK_PLAYER,
-    (u8)~MASK_PLAYER,
-    (u8)~MASK_PLAYER,
-    (u8)~MASK_PLAYER,
-    (u8)~MASK_PLAYER,
-    (u8)~MASK_PLAYER,
-    (u8)~MASK_PLAYER,
-    (u8)~MASK_PLAYER,
-    (u8)~MASK_PLAYER,
-    (u8)~MASK_PLAYER,
-    (u8)~MASK_PLAYER,
-    (u8)~MASK_PLAYER,
-    (u8)~MASK_PLAYER,
-    (u8)~MASK_PLAYER,
-};
-
-static const i16 PLAYER_SHADOW_RADIUS_SQUARED =
-    PLAYER_SHADOW_RADIUS * PLAYER_SHADOW_RADIUS;
-
-static void set_mask(u8 mask[PX_HEIGHT][PX_WIDTH], const Player* player) {
-    {
-        // NOTE: `PX_WIDTH_BY_HEIGHT` *must* to be divisible by 16.
-        u8* pointer = &mask[0][0];
-        for (u16 i = 0; i < PX_WIDTH_BY_HEIGHT; i = (u16)(i + 16)) {
-            _mm_store_si128((Simd4i32*)&pointer[i],
-                            _mm_and_si128(*(Simd4i32*)&pointer[i],
-                                          *(Simd4i32*)&MASK_RESET[0]));
-        }
-    }
-    const i16 x = (i16)player->x;
-    const i16 y = (i16)player->y;
-    mask[y][x] &= MASK_PLAYER;
-    Octal octal = {
-        .slope_start = 1.0f,
-        .slope_end = 0.0f,
-        .x = x,
-        .y = y,
-        .loop_start = 1,
-        .radius = PLAYER_SHADOW_RADIUS,
-        .radius_squared = PLAYER_SHADOW_RADIUS_SQUARED,
-        .mask = MASK_PLAYER,
-    };
-    {
-        octal.x_sign = 1;
-        octal.y_sign = 1;
-        set_mask_col_row(mask, octal);
-        set_mask_row_col(mask, octal);
-    }
-    {
-        octal.x_sign = 1;
-        octal.y_sign = -1;
-        set_mask_col_row(mask, octal);
-        set_mask_row_col(mask, octal);
-    }
-    {
-        octal.x_sign = -1;
-        octal.y_sign = -1;
-        set_mask_col_row(mask, octal);
-        set_mask_row_col(mask, octal);
-    }
-    {
-        octal.x_sign = -1;
-        octal.y_sign = 1;
-        set_mask_col_row(mask, octal);
-        set_mask_row_col(mask, octal);
-    }
-}
-
-static void set_buffer(Pixel         buffer[PX_HEIGHT][PX_WIDTH],
+// NOTE: Only the cells under `camera` are composited, so the cost of this
+// (and of the texture upload) follows the view, not the map.
+static void set_buffer(Pixel         buffer[VIEW_HEIGHT][VIEW_WIDTH],
                        u8            mask[PX_HEIGHT][PX_WIDTH],
-                       const Player* player) {
-    for (u8 i = 0; i < PX_HEIGHT; ++i) {
-        for (u8 j = 0; j < PX_WIDTH; ++j) {
-            if (mask[i][j] & MASK_WALL) {
-                buffer[i][j].pack = COLOR_WALL.pack;
-            } else {
-                buffer[i][j].pack = COLOR_EMPTY.pack;
+                       u8            light[PX_HEIGHT][PX_WIDTH],
+                       const Player* player,
+                       const Bounds* camera) {
+    if (light) {
+        for (u8 i = 0; i < VIEW_HEIGHT; ++i) {
+            const i16 y = (i16)(camera->y0 + i);
+            for (u8 j = 0; j < VIEW_WIDTH; ++j) {
+                const i16 x = (i16)(camera->x0 + j);
+                const u8  level = (u8)(light[y][x] >> LIGHT_SHIFT);
+                buffer[i][j].pack =
+                    LIGHT_LUT[mask[y][x] & MASK_WALL][level].pack;
             }
-            if (mask[i][j] & MASK_PLAYER) {
-                buffer[i][j].rgb.red =
-                    (u8)(buffer[i][j].rgb.red + COLOR_LIGHT.rgb.red);
-                buffer[i][j].rgb.green =
-                    (u8)(buffer[i][j].rgb.green + COLOR_LIGHT.rgb.green);
-                buffer[i][j].rgb.blue =
-                    (u8)(buffer[i][j].rgb.blue + COLOR_LIGHT.rgb.blue);
+        }
+    } else {
+        for (u8 i = 0; i < VIEW_HEIGHT; ++i) {
+            const i16 y = (i16)(camera->y0 + i);
+            for (u8 j = 0; j < VIEW_WIDTH; ++j) {
+                const i16 x = (i16)(camera->x0 + j);
+                if (mask[y][x] & MASK_WALL) {
+                    buffer[i][j].pack = COLOR_WALL.pack;
+                } else {
+                    buffer[i][j].pack = COLOR_EMPTY.pack;
+                }
+                if (mask[y][x] & MASK_PLAYER) {
+                    buffer[i][j].rgb.red =
+                        (u8)(buffer[i][j].rgb.red + COLOR_LIGHT.rgb.red);
+                    buffer[i][j].rgb.green =
+                        (u8)(buffer[i][j].rgb.green + COLOR_LIGHT.rgb.green);
+                    buffer[i][j].rgb.blue =
+                        (u8)(buffer[i][j].rgb.blue + COLOR_LIGHT.rgb.blue);
+                }
             }
         }
     }
-    buffer[(u8)player->y][(u8)player->x].pack = COLOR_PLAYER.pack;
+    buffer[(i16)player->y - camera->y0][(i16)player->x - camera->x0].pack =
+        COLOR_PLAYER.pack;
 }
 
-static void set_debug(const Player* player, Frame* frame) {
+static void set_debug(const Player* player,
+                      Frame*        frame,
+                      const Arena*  permanent,
+                      const Arena*  scratch,
+                      usize         scratch_setup) {
     u32       now = SDL_GetTicks();
     const f32 elapsed = (f32)(now - frame->start);
     if (elapsed < FRAME_DURATION) {
         SDL_Delay((u32)(FRAME_DURATION - elapsed));
     }
     if (FRAME_DEBUG_INTERVAL <= ++frame->fps_count) {
-        printf("\033[8A"
+        printf("\033[11A"
                "frames  / sec.       :%6.2f\n"
                "updates / frame      :%6.2f\n"
                "player.x             :%6.2f\n"
@@ -231,7 +221,10 @@ static void set_debug(const Player* player, Frame* frame) {
                "player.control.up    :%6hu\n"
                "player.control.down  :%6hu\n"
                "player.control.left  :%6hu\n"
-               "player.control.right :%6hu\n",
+               "player.control.right :%6hu\n"
+               "arena.permanent (kb) :%6.2f\n"
+               "scratch setup   (kb) :%6.2f\n"
+               "scratch / frame (kb) :%6.2f\n",
                ((f32)frame->fps_count / (f32)(now - frame->fps_start)) *
                    MILLISECONDS,
                (f32)frame->update_count / (f32)FRAME_DEBUG_INTERVAL,
@@ -240,37 +233,114 @@ static void set_debug(const Player* player, Frame* frame) {
                player->control[DIR_UP],
                player->control[DIR_DOWN],
                player->control[DIR_LEFT],
-               player->control[DIR_RIGHT]);
+               player->control[DIR_RIGHT],
+               (f32)permanent->high_water / 1024.0f,
+               (f32)scratch_setup / 1024.0f,
+               (f32)scratch->high_water / 1024.0f);
         frame->fps_start = frame->start;
         frame->fps_count = 0;
         frame->update_count = 0;
     }
 }
 
-static const u32 TEXTURE_WIDTH = PX_WIDTH * sizeof(Pixel);
+static const u32 TEXTURE_WIDTH = VIEW_WIDTH * sizeof(Pixel);
 
-static void loop(SDL_Renderer* renderer,
-                 SDL_Texture*  texture,
-                 Memory*       memory) {
+static Memory* alloc_memory(void) {
+    const usize offset = align_up(sizeof(Memory), ARENA_ALIGN);
+    const Block block =
+        alloc_block(offset + ARENA_PERMANENT_CAP + ARENA_SCRATCH_CAP);
+    if ((uintptr_t)block.pointer % _Alignof(Memory)) {
+        ERROR("(uintptr_t)block.pointer % _Alignof(Memory)");
+    }
+    u8*     base = (u8*)block.pointer;
+    Memory* memory = (Memory*)block.pointer;
+    memory->block = block;
+    init_arena(&memory->permanent, &base[offset], ARENA_PERMANENT_CAP);
+    init_arena(&memory->scratch,
+               &base[offset + ARENA_PERMANENT_CAP],
+               ARENA_SCRATCH_CAP);
+    return memory;
+}
+
+static void init_memory(Memory* memory) {
+    memset(&memory->player, 0, sizeof(Player));
+    memset(&memory->frame, 0, sizeof(Frame));
     Player* player = &memory->player;
     player->x = PX_WIDTH / 2.0f;
     player->y = PX_HEIGHT / 2.0f;
     player->next_x = player->x;
     player->next_y = player->y;
-    Frame* frame = &memory->frame;
-    Bool*  dead = &memory->dead;
-    Pixel* pointer = &memory->buffer[0][0];
     init_mask(memory->mask);
-    printf("\n\n\n\n\n\n\n\n");
+    init_light_lut();
+}
+
+// NOTE: The light plane lives in `Memory` rather than scratch, so nothing is
+// allocated per frame and only the camera rect of it is cleared.
+static u8 (*get_light(Memory* memory))[PX_WIDTH] {
+    return memory->lighting == LIGHTING_SOFT ? memory->light : NULL;
+}
+
+// NOTE: The PVS only records binary visibility, so soft lighting always
+// shadowcasts. A light whose radius misses the camera is skipped outright,
+// and the rest are only cast out to the edges of the camera, which the
+// caller updates first.
+static void set_memory_mask(Memory* memory, u8 light[PX_HEIGHT][PX_WIDTH]) {
+    const i16 x = (i16)memory->player.x;
+    const i16 y = (i16)memory->player.y;
+    if (!get_bounds_intersect(&memory->camera, x, y, PLAYER_SHADOW_RADIUS)) {
+        reset_mask_bounds(memory->mask, light, &memory->camera);
+    } else if (memory->pvs && (!light)) {
+        set_mask_pvs(memory->mask, memory->pvs, x, y, &memory->camera);
+    } else {
+        set_mask_bounds(memory->mask,
+                        light,
+                        x,
+                        y,
+                        PLAYER_SHADOW_RADIUS,
+                        &memory->camera);
+    }
+}
+
+// NOTE: Binary lighting (toggled with space) reads the player's visibility
+// out of the PVS instead of shadowcasting every frame.
+static void init_pvs(Memory* memory) {
+    memory->pvs = alloc_arena(&memory->permanent, sizeof(Pvs));
+    build_pvs(memory->pvs,
+              &memory->permanent,
+              &memory->scratch,
+              memory->mask,
+              PLAYER_SHADOW_RADIUS);
+}
+
+static void loop(SDL_Renderer* renderer,
+                 SDL_Texture*  texture,
+                 Memory*       memory) {
+    init_memory(memory);
+    init_pvs(memory);
+    memory->scratch_setup = take_high_water(&memory->scratch);
+    Player* player = &memory->player;
+    Frame*  frame = &memory->frame;
+    Bool*   dead = &memory->dead;
+    // NOTE: Taking `&memory->buffer[0][0]` as a `Pixel*` here makes gcc's
+    // `-Wstringop-overflow` think `set_buffer` only gets the first row.
+    void* pointer = memory->buffer;
+    printf("\n\n\n\n\n\n\n\n\n\n\n");
     for (;;) {
         frame->start = SDL_GetTicks();
-        set_input(player, dead);
+        set_input(player, &memory->lighting, dead);
         if (*dead) {
             return;
         }
+        reset_arena(&memory->scratch);
         update_frame(memory->mask, player, frame);
-        set_mask(memory->mask, player);
-        set_buffer(memory->buffer, memory->mask, player);
+        set_camera(&memory->camera, player);
+        u8(*light)[PX_WIDTH] = get_light(memory);
+        set_memory_mask(memory, light);
+        set_buffer(memory->buffer,
+                   memory->mask,
+                   light,
+                   player,
+                   &memory->camera);
         if (SDL_RenderClear(renderer) < 0) {
             ERROR("SDL_RenderClear(...) < 0");
         }
@@ -281,14 +351,280 @@ static void loop(SDL_Renderer* renderer,
             ERROR("SDL_RenderCopy(...) < 0");
         }
         SDL_RenderPresent(renderer);
-        set_debug(player, frame);
+        set_debug(player,
+                  frame,
+                  &memory->permanent,
+                  &memory->scratch,
+                  memory->scratch_setup);
     }
 }
 
-static const u32 WINDOW_WIDTH = PX_WIDTH * PX_SCALE;
-static const u32 WINDOW_HEIGHT = PX_HEIGHT * PX_SCALE;
+#define HEADLESS_TURN_INTERVAL 90
+
+static f32 get_seconds(void) {
+    struct timespec time;
+    if (clock_gettime(CLOCK_MONOTONIC, &time)) {
+        ERROR("clock_gettime(...)");
+    }
+    return (f32)time.tv_sec + ((f32)time.tv_nsec / 1000000000.0f);
+}
+
+// NOTE: Without a display there is no input, so the player is steered by a
+// fixed schedule and the frame clock is simulated; the same arguments always
+// produce the same frames.
+static f32 loop_headless(Memory* memory, Capture* capture, u32 frame_count) {
+    init_memory(memory);
+    memory->scratch_setup = take_high_water(&memory->scratch);
+    Player*   player = &memory->player;
+    Frame*    frame = &memory->frame;
+    const f32 start = get_seconds();
+    for (u32 i = 0; i < frame_count; ++i) {
+        const Direction direction =
+            (Direction)((i / HEADLESS_TURN_INTERVAL) % DIR_COUNT);
+        for (u8 j = 0; j < DIR_COUNT; ++j) {
+            player->control[j] = j == direction ? 1 : 0;
+        }
+        reset_arena(&memory->scratch);
+        frame->start = (u32)((f32)i * FRAME_DURATION);
+        update_frame(memory->mask, player, frame);
+        set_camera(&memory->camera, player);
+        u8(*light)[PX_WIDTH] = get_light(memory);
+        set_memory_mask(memory, light);
+        set_buffer(memory->buffer,
+                   memory->mask,
+                   light,
+                   player,
+                   &memory->camera);
+        if (capture) {
+            capture_push(capture, memory->buffer, i);
+        }
+    }
+    return get_seconds() - start;
+}
+
+static void print_headless(const Memory* memory,
+                           u32           frame_count,
+                           f32           elapsed) {
+    printf("frames               :%9u\n"
+           "seconds              :%9.3f\n"
+           "frames  / sec.       :%9.2f\n"
+           "arena.permanent (kb) :%9.2f\n"
+           "scratch setup   (kb) :%9.2f\n"
+           "scratch / frame (kb) :%9.2f\n",
+           frame_count,
+           elapsed,
+           (f32)frame_count / elapsed,
+           (f32)memory->permanent.high_water / 1024.0f,
+           (f32)memory->scratch_setup / 1024.0f,
+           (f32)memory->scratch.high_water / 1024.0f);
+}
+
+// NOTE: Runs the same deterministic headless loop once per lighting mode so
+// the cost of soft lighting can be read off against the binary mask path.
+static void bench_lighting(Memory* memory, u32 frame_count) {
+    memory->lighting = LIGHTING_BINARY;
+    const f32 binary = loop_headless(memory, NULL, frame_count);
+    memory->lighting = LIGHTING_SOFT;
+    const f32 soft = loop_headless(memory, NULL, frame_count);
+    printf("frames               :%9u\n"
+           "binary  usec / frame :%9.3f\n"
+           "soft    usec / frame :%9.3f\n"
+           "soft    / binary     :%9.3f\n",
+           frame_count,
+           (binary / (f32)frame_count) * 1000000.0f,
+           (soft / (f32)frame_count) * 1000000.0f,
+           soft / binary);
+}
+
+// NOTE: The lookup loop is rerun for cache sizes from one entry up to
+// `PVS_CACHE_CAP`, so cache memory can be read off against hit rate.
+static void bench_pvs(Memory* memory, const char* path, u32 frame_count) {
+    init_memory(memory);
+    Pvs*      pvs = alloc_arena(&memory->permanent, sizeof(Pvs));
+    const f32 start = get_seconds();
+    const Bool loaded = load_pvs(pvs,
+                                 &memory->permanent,
+                                 memory->mask,
+                                 PLAYER_SHADOW_RADIUS,
+                                 path);
+    if (!loaded) {
+        build_pvs(pvs,
+                  &memory->permanent,
+                  &memory->scratch,
+                  memory->mask,
+                  PLAYER_SHADOW_RADIUS);
+        save_pvs(pvs, memory->mask, path);
+    }
+    const f32 setup = get_seconds() - start;
+    memory->lighting = LIGHTING_BINARY;
+    memory->pvs = NULL;
+    const f32   shadowcast = loop_headless(memory, NULL, frame_count);
+    const usize raw = sizeof(u64[PVS_CELLS][PVS_WORDS]);
+    const usize compressed =
+        sizeof(u32[PVS_CELLS + 1]) + (sizeof(u16) * pvs->run_count);
+    printf("pvs.loaded           :%9u\n"
+           "pvs.setup (msec)     :%9.3f\n"
+           "pvs.raw (kb)         :%9.2f\n"
+           "pvs.compressed (kb)  :%9.2f\n"
+           "shadowcast usec / fr :%9.3f\n\n"
+           "cache  cache (kb)  hit rate   decodes  usec / fr\n",
+           loaded,
+           setup * MILLISECONDS,
+           (f32)raw / 1024.0f,
+           (f32)compressed / 1024.0f,
+           (shadowcast / (f32)frame_count) * 1000000.0f);
+    memory->pvs = pvs;
+    for (u8 cache_cap = 1; cache_cap <= PVS_CACHE_CAP;
+         cache_cap = (u8)(cache_cap * 2))
+    {
+        set_pvs_cache_cap(pvs, cache_cap);
+        const f32 lookup = loop_headless(memory, NULL, frame_count);
+        printf("%5u %11.2f %9.3f %9u %10.3f\n",
+               cache_cap,
+               (f32)(sizeof(PvsEntry) * cache_cap) / 1024.0f,
+               (f32)pvs->hits / (f32)(pvs->hits + pvs->misses),
+               pvs->decodes,
+               (lookup / (f32)frame_count) * 1000000.0f);
+    }
+}
+
+#define SIGHT_SHARED_SOURCES 64
+#define SIGHT_RANDOM_SEED    0x9E3779B9u
+
+// NOTE: Half the queries share a few busy sources, half are one-offs; every
+// answer is checked against a full `set_mask` from its source. The batch can
+// be far bigger than the scratch arena, so it gets a block sized to fit.
+static void bench_sight(Memory* memory, u32 count) {
+    init_memory(memory);
+    const usize size = (2 * ARENA_ALIGN) + (sizeof(SightQuery) * count) +
+                       (sizeof(Bool) * count) + get_sight_scratch_size(count);
+    const Block block = alloc_block(size);
+    Arena       scratch;
+    init_arena(&scratch, block.pointer, block.size);
+    SightQuery* queries = alloc_arena(&scratch, sizeof(SightQuery) * count);
+    Bool*       results = alloc_arena(&scratch, sizeof(Bool) * count);
+    u32         state = SIGHT_RANDOM_SEED;
+    u8          shared[SIGHT_SHARED_SOURCES][2];
+    for (u8 i = 0; i < SIGHT_SHARED_SOURCES; ++i) {
+        get_open_cell(memory->mask, &state, &shared[i][0], &shared[i][1]);
+    }
+    for (u32 i = 0; i < count; ++i) {
+        SightQuery* query = &queries[i];
+        if (i & 1) {
+            const u32 j = get_random(&state) % SIGHT_SHARED_SOURCES;
+            query->source_x = shared[j][0];
+            query->source_y = shared[j][1];
+        } else {
+            get_open_cell(memory->mask,
+                          &state,
+                          &query->source_x,
+                          &query->source_y);
+        }
+        get_open_cell(memory->mask,
+                      &state,
+                      &query->target_x,
+                      &query->target_y);
+    }
+    SightPool pool;
+    init_sight_pool(&pool);
+    const f32 start = get_seconds();
+    query_sight(&pool,
+                memory->mask,
+                queries,
+                count,
+                PLAYER_SHADOW_RADIUS,
+                results,
+                &scratch);
+    const f32 elapsed = get_seconds() - start;
+    free_sight_pool(&pool);
+    const u32 visible = check_sight(memory->mask,
+                                    queries,
+                                    count,
+                                    PLAYER_SHADOW_RADIUS,
+                                    results);
+    printf("queries              :%9u\n"
+           "visible              :%9u\n"
+           "usec / query         :%9.3f\n"
+           "arena.scratch   (kb) :%9.2f\n",
+           count,
+           visible,
+           (elapsed / (f32)count) * 1000000.0f,
+           (f32)scratch.high_water / 1024.0f);
+    free_block(block);
+}
+
+static void usage(const char* name) {
+    fprintf(stderr,
+            "usage: %s\n"
+            "       %s capture ppm <directory> <frames>\n"
+            "       %s capture raw <file> <frames>\n"
+            "       %s headless <frames>\n"
+            "       %s bench <frames>\n"
+            "       %s pvs <file> <frames>\n"
+            "       %s sight <queries>\n",
+            name,
+            name,
+            name,
+            name,
+            name,
+            name,
+            name);
+    exit(EXIT_FAILURE);
+}
+
+static u32 parse_frame_count(const char* name, const char* string) {
+    char*               end;
+    const unsigned long frame_count = strtoul(string, &end, 10);
+    if ((*end != '\0') || (frame_count == 0) || (UINT32_MAX < frame_count)) {
+        usage(name);
+    }
+    return (u32)frame_count;
+}
+
+static i32 main_headless(Memory* memory, i32 argc, char** argv) {
+    if ((argc == 3) && (!strcmp(argv[1], "headless"))) {
+        const u32 frame_count = parse_frame_count(argv[0], argv[2]);
+        const f32 elapsed = loop_headless(memory, NULL, frame_count);
+        print_headless(memory, frame_count, elapsed);
+        return EXIT_SUCCESS;
+    }
+    if ((argc == 3) && (!strcmp(argv[1], "bench"))) {
+        bench_lighting(memory, parse_frame_count(argv[0], argv[2]));
+        return EXIT_SUCCESS;
+    }
+    if ((argc == 3) && (!strcmp(argv[1], "sight"))) {
+        bench_sight(memory, parse_frame_count(argv[0], argv[2]));
+        return EXIT_SUCCESS;
+    }
+    if ((argc == 4) && (!strcmp(argv[1], "pvs"))) {
+        bench_pvs(memory, argv[2], parse_frame_count(argv[0], argv[3]));
+        return EXIT_SUCCESS;
+    }
+    if ((argc != 5) || strcmp(argv[1], "capture")) {
+        usage(argv[0]);
+    }
+    CaptureFormat format = CAPTURE_PPM;
+    if (!strcmp(argv[2], "ppm")) {
+        format = CAPTURE_PPM;
+    } else if (!strcmp(argv[2], "raw")) {
+        format = CAPTURE_RAW;
+    } else {
+        usage(argv[0]);
+    }
+    const u32 frame_count = parse_frame_count(argv[0], argv[4]);
+    Capture*  capture = alloc_arena(&memory->permanent, sizeof(Capture));
+    capture_start(capture, format, argv[3]);
+    const f32 elapsed = loop_headless(memory, capture, frame_count);
+    capture_stop(capture);
+    print_headless(memory, frame_count, elapsed);
+    printf("capture.stalls       :%9u\n", capture->stalls);
+    return EXIT_SUCCESS;
+}
+
+static const u32 WINDOW_WIDTH = VIEW_WIDTH * PX_SCALE;
+static const u32 WINDOW_HEIGHT = VIEW_HEIGHT * PX_SCALE;
 
-i32 main(void) {
+i32 main(i32 argc, char** argv) {
     printf("sizeof(Frame)          : %zu\n"
            "sizeof(Rgb)            : %zu\n"
            "sizeof(Pixel)          : %zu\n"
@@ -296,6 +632,10 @@ i32 main(void) {
            "sizeof(HorizontalLine) : %zu\n"
            "sizeof(VerticalLine)   : %zu\n"
            "sizeof(Octal)          : %zu\n"
+           "sizeof(Bounds)         : %zu\n"
+           "sizeof(Capture)        : %zu\n"
+           "sizeof(Arena)          : %zu\n"
+           "sizeof(Pvs)            : %zu\n"
            "sizeof(Memory)         : %zu\n\n",
            sizeof(Frame),
            sizeof(Rgb),
@@ -304,10 +644,20 @@ i32 main(void) {
            sizeof(HorizontalLine),
            sizeof(VerticalLine),
            sizeof(Octal),
+           sizeof(Bounds),
+           sizeof(Capture),
+           sizeof(Arena),
+           sizeof(Pvs),
            sizeof(Memory));
-    Memory* memory = calloc(1, sizeof(Memory));
-    if (!memory) {
-        ERROR("!memory");
+    Memory* memory = alloc_memory();
+    printf("memory.block.size      : %zu\n"
+           "memory.block.huge      : %u\n\n",
+           memory->block.size,
+           memory->block.huge);
+    if (1 < argc) {
+        const i32 status = main_headless(memory, argc, argv);
+        free_block(memory->block);
+        return status;
     }
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         ERROR("SDL_Init(...) < 0");
@@ -326,8 +676,8 @@ i32 main(void) {
     if (!renderer) {
         ERROR("!renderer");
     }
-    SDL_SetWindowMinimumSize(window, PX_WIDTH, PX_HEIGHT);
-    if (SDL_RenderSetLogicalSize(renderer, PX_WIDTH, PX_HEIGHT) < 0) {
+    SDL_SetWindowMinimumSize(window, VIEW_WIDTH, VIEW_HEIGHT);
+    if (SDL_RenderSetLogicalSize(renderer, VIEW_WIDTH, VIEW_HEIGHT) < 0) {
         ERROR("SDL_RenderSetLogicalSize(...) < 0");
     }
     if (SDL_RenderSetIntegerScale(renderer, 1) < 0) {
@@ -336,8 +686,8 @@ i32 main(void) {
     SDL_Texture* texture = SDL_CreateTexture(renderer,
                                              SDL_PIXELFORMAT_BGR888,
                                              SDL_TEXTUREACCESS_STREAMING,
-                                             PX_WIDTH,
-                                             PX_HEIGHT);
+                                             VIEW_WIDTH,
+                                             VIEW_HEIGHT);
     if (!texture) {
         ERROR("!texture");
     }
@@ -348,7 +698,7 @@ i32 main(void) {
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
-    free(memory);
+    free_block(memory->block);
     printf("\nDone!\n");
     return EXIT_SUCCESS;
 }
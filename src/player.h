@@ -77,4 +77,15 @@ static void update_player_position(u8      mask[PX_HEIGHT][PX_WIDTH],
     }
 }
 
+static void set_camera(Bounds* camera, const Player* player) {
+    camera->x0 = clamp_i16((i16)((i16)player->x - (VIEW_WIDTH / 2)),
+                           0,
+                           PX_WIDTH - VIEW_WIDTH);
+    camera->y0 = clamp_i16((i16)((i16)player->y - (VIEW_HEIGHT / 2)),
+                           0,
+                           PX_HEIGHT - VIEW_HEIGHT);
+    camera->x1 = (i16)(camera->x0 + VIEW_WIDTH);
+    camera->y1 = (i16)(camera->y0 + VIEW_HEIGHT);
+}
+
 #endif
@@ -2,6 +2,7 @@
 #define __PRELUDE_H__
 
 #include <immintrin.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 
@@ -10,6 +11,8 @@ typedef uint16_t u16;
 typedef uint32_t u32;
 typedef uint64_t u64;
 
+typedef size_t usize;
+
 typedef int8_t  i8;
 typedef int16_t i16;
 typedef int32_t i32;
@@ -37,12 +40,51 @@ typedef enum {
 #define PX_WIDTH  32
 #define PX_HEIGHT 32
 
+// NOTE: The camera only ever shows `VIEW_WIDTH` by `VIEW_HEIGHT` cells of
+// the map, which must be no larger than it.
+#define VIEW_WIDTH  24
+#define VIEW_HEIGHT 24
+
 #define PX_SCALE 24
 
 static const u16 PX_WIDTH_BY_HEIGHT = PX_WIDTH * PX_HEIGHT;
 
+// NOTE: Half-open rectangle of cells, `[x0, x1) x [y0, y1)`.
+typedef struct {
+    i16 x0;
+    i16 y0;
+    i16 x1;
+    i16 y1;
+} Bounds;
+
+// NOTE: See `https://en.wikipedia.org/wiki/Xorshift`.
+static u32 get_random(u32* state) {
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static f32 min_f32(f32 a, f32 b) {
+    return a < b ? a : b;
+}
+
+static f32 max_f32(f32 a, f32 b) {
+    return a < b ? b : a;
+}
+
 static f32 clamp_f32(f32 x, f32 min, f32 max) {
     return x < min ? min : max < x ? max : x;
 }
 
+static i16 min_i16(i16 a, i16 b) {
+    return a < b ? a : b;
+}
+
+static i16 clamp_i16(i16 x, i16 min, i16 max) {
+    return x < min ? min : max < x ? max : x;
+}
+
 #endif
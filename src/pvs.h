@@ -0,0 +1,366 @@
+#ifndef __PVS_H__
+#define __PVS_H__
+
+#include "arena.h"
+#include "geom.h"
+
+// NOTE: The potentially visible set (PVS) stores, for every cell, the
+// `MASK_PLAYER` bits a shadowcast from that cell would produce against the
+// static walls. Each cell is run-length encoded; every `PVS_KEYFRAME`-th cell
+// in a row is encoded as-is, the cells between are encoded as the XOR against
+// their left neighbour, which is usually a handful of runs. Decoded sets are
+// kept in a small LRU cache, since the player mostly walks between
+// neighbouring cells; how many of its `PVS_CACHE_CAP` slots are in use is set
+// at runtime, so memory can be traded against hit rate.
+#define PVS_WORDS         ((PX_WIDTH * PX_HEIGHT) / 64)
+#define PVS_CELLS         (PX_WIDTH * PX_HEIGHT)
+#define PVS_KEYFRAME      8
+#define PVS_CACHE_CAP     64
+#define PVS_CACHE_DEFAULT 16
+#define PVS_MAGIC         0x31535650
+
+typedef struct {
+    u64 bits[PVS_WORDS];
+    u32 cell;
+    u32 last_used;
+} PvsEntry;
+
+typedef struct {
+    u32*     offsets;
+    u16*     runs;
+    u32      run_count;
+    i16      radius;
+    u32      tick;
+    u32      hits;
+    u32      misses;
+    u32      decodes;
+    u8       cache_cap;
+    PvsEntry cache[PVS_CACHE_CAP];
+} Pvs;
+
+typedef struct {
+    u32 magic;
+    u16 width;
+    u16 height;
+    u32 wall_hash;
+    u32 radius;
+    u32 run_count;
+} PvsHeader;
+
+static u32 get_wall_hash(u8 mask[PX_HEIGHT][PX_WIDTH]) {
+    u32 hash = 2166136261u;
+    for (u8 i = 0; i < PX_HEIGHT; ++i) {
+        for (u8 j = 0; j < PX_WIDTH; ++j) {
+            hash = (hash ^ (u32)(mask[i][j] & MASK_WALL)) * 16777619u;
+        }
+    }
+    return hash;
+}
+
+static void get_mask_bits(u8 mask[PX_HEIGHT][PX_WIDTH], u64 bits[PVS_WORDS]) {
+    memset(bits, 0, sizeof(u64[PVS_WORDS]));
+    for (u16 k = 0; k < PVS_CELLS; ++k) {
+        if (mask[k / PX_WIDTH][k % PX_WIDTH] & MASK_PLAYER) {
+            bits[k / 64] |= 1lu << (k % 64);
+        }
+    }
+}
+
+// NOTE: Runs alternate between unchanged and flipped bits, starting with an
+// unchanged run. A `NULL` `runs` only counts them.
+static u32 encode_runs(const u64 bits[PVS_WORDS], u16* runs) {
+    u32  count = 0;
+    u16  length = 0;
+    Bool flipped = FALSE;
+    for (u16 k = 0; k < PVS_CELLS; ++k) {
+        const Bool bit = (bits[k / 64] >> (k % 64)) & 1lu ? TRUE : FALSE;
+        if (bit != flipped) {
+            if (runs) {
+                runs[count] = length;
+            }
+            ++count;
+            length = 0;
+            flipped = bit;
+        }
+        ++length;
+    }
+    if (flipped) {
+        if (runs) {
+            runs[count] = length;
+        }
+        ++count;
+    }
+    return count;
+}
+
+static void flip_bits(u64 bits[PVS_WORDS], u16 start, u16 end) {
+    for (u16 k = start; k < end;) {
+        const u16 offset = k % 64;
+        const u16 width = (u16)(end - k) < (u16)(64 - offset)
+                              ? (u16)(end - k)
+                              : (u16)(64 - offset);
+        const u64 flip = width == 64 ? ~0lu : ((1lu << width) - 1) << offset;
+        bits[k / 64] ^= flip;
+        k = (u16)(k + width);
+    }
+}
+
+static void decode_runs(const u16* runs, u32 count, u64 bits[PVS_WORDS]) {
+    u16 k = 0;
+    for (u32 i = 0; i < count; ++i) {
+        if (i & 1) {
+            flip_bits(bits, k, (u16)(k + runs[i]));
+        }
+        k = (u16)(k + runs[i]);
+    }
+}
+
+// NOTE: Returns whether `cell` was already cached. Walking left to the
+// nearest keyframe only shows up in `decodes`; `hits` and `misses` are
+// counted once per lookup by the caller.
+static Bool get_pvs_bits(Pvs* pvs, u32 cell, u64 bits[PVS_WORDS]) {
+    ++pvs->tick;
+    PvsEntry* oldest = &pvs->cache[0];
+    for (u8 i = 0; i < pvs->cache_cap; ++i) {
+        PvsEntry* entry = &pvs->cache[i];
+        if (entry->cell == cell) {
+            entry->last_used = pvs->tick;
+            memcpy(bits, entry->bits, sizeof(u64[PVS_WORDS]));
+            return TRUE;
+        }
+        if (entry->last_used < oldest->last_used) {
+            oldest = entry;
+        }
+    }
+    if ((cell % PX_WIDTH) % PVS_KEYFRAME) {
+        // NOTE: This may evict `oldest`, so only pick the victim afterwards.
+        get_pvs_bits(pvs, cell - 1, bits);
+        oldest = &pvs->cache[0];
+        for (u8 i = 1; i < pvs->cache_cap; ++i) {
+            if (pvs->cache[i].last_used < oldest->last_used) {
+                oldest = &pvs->cache[i];
+            }
+        }
+    } else {
+        memset(bits, 0, sizeof(u64[PVS_WORDS]));
+    }
+    ++pvs->decodes;
+    decode_runs(&pvs->runs[pvs->offsets[cell]],
+                pvs->offsets[cell + 1] - pvs->offsets[cell],
+                bits);
+    oldest->cell = cell;
+    oldest->last_used = pvs->tick;
+    memcpy(oldest->bits, bits, sizeof(u64[PVS_WORDS]));
+    return FALSE;
+}
+
+static void reset_pvs_cache(Pvs* pvs) {
+    for (u8 i = 0; i < PVS_CACHE_CAP; ++i) {
+        pvs->cache[i].cell = UINT32_MAX;
+        pvs->cache[i].last_used = 0;
+    }
+    pvs->tick = 0;
+    pvs->hits = 0;
+    pvs->misses = 0;
+    pvs->decodes = 0;
+}
+
+// NOTE: Only the first `cache_cap` entries are used; changing it starts the
+// cache and its counters over.
+static void set_pvs_cache_cap(Pvs* pvs, u8 cache_cap) {
+    if ((cache_cap == 0) || (PVS_CACHE_CAP < cache_cap)) {
+        ERROR("(cache_cap == 0) || (PVS_CACHE_CAP < cache_cap)");
+    }
+    pvs->cache_cap = cache_cap;
+    reset_pvs_cache(pvs);
+}
+
+static void alloc_pvs_tables(Pvs* pvs, Arena* permanent, u32 run_count) {
+    pvs->run_count = run_count;
+    pvs->offsets = alloc_arena(permanent, sizeof(u32[PVS_CELLS + 1]));
+    pvs->runs = alloc_arena(permanent, sizeof(u16) * run_count);
+}
+
+// NOTE: Raw sets for every cell are held in the scratch arena while encoding,
+// so it must not be in use by the caller.
+static void build_pvs(Pvs*   pvs,
+                      Arena* permanent,
+                      Arena* scratch,
+                      u8     mask[PX_HEIGHT][PX_WIDTH],
+                      i16    radius) {
+    reset_arena(scratch);
+    u64(*raw)[PVS_WORDS] =
+        alloc_arena(scratch, sizeof(u64[PVS_CELLS][PVS_WORDS]));
+    pvs->radius = radius;
+    for (u16 k = 0; k < PVS_CELLS; ++k) {
+        const i16 x = (i16)(k % PX_WIDTH);
+        const i16 y = (i16)(k / PX_WIDTH);
+        if (mask[y][x] & MASK_WALL) {
+            memset(raw[k], 0, sizeof(u64[PVS_WORDS]));
+            continue;
+        }
+        set_mask(mask, NULL, x, y, radius);
+        get_mask_bits(mask, raw[k]);
+    }
+    reset_mask(mask);
+    u64 delta[PVS_WORDS];
+    u32 run_count = 0;
+    for (u16 k = 0; k < PVS_CELLS; ++k) {
+        if ((k % PX_WIDTH) % PVS_KEYFRAME) {
+            for (u8 i = 0; i < PVS_WORDS; ++i) {
+                delta[i] = raw[k][i] ^ raw[k - 1][i];
+            }
+            run_count += encode_runs(delta, NULL);
+        } else {
+            run_count += encode_runs(raw[k], NULL);
+        }
+    }
+    alloc_pvs_tables(pvs, permanent, run_count);
+    run_count = 0;
+    for (u16 k = 0; k < PVS_CELLS; ++k) {
+        pvs->offsets[k] = run_count;
+        if ((k % PX_WIDTH) % PVS_KEYFRAME) {
+            for (u8 i = 0; i < PVS_WORDS; ++i) {
+                delta[i] = raw[k][i] ^ raw[k - 1][i];
+            }
+            run_count += encode_runs(delta, &pvs->runs[run_count]);
+        } else {
+            run_count += encode_runs(raw[k], &pvs->runs[run_count]);
+        }
+    }
+    pvs->offsets[PVS_CELLS] = run_count;
+    set_pvs_cache_cap(pvs, PVS_CACHE_DEFAULT);
+    for (u16 k = 0; k < PVS_CELLS; ++k) {
+        get_pvs_bits(pvs, k, delta);
+        if (memcmp(delta, raw[k], sizeof(u64[PVS_WORDS]))) {
+            ERROR("memcmp(delta, raw[k], ...)");
+        }
+    }
+    reset_pvs_cache(pvs);
+    reset_arena(scratch);
+}
+
+static void save_pvs(const Pvs*  pvs,
+                     u8          mask[PX_HEIGHT][PX_WIDTH],
+                     const char* path) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        ERROR("!file");
+    }
+    const PvsHeader header = {
+        .magic = PVS_MAGIC,
+        .width = PX_WIDTH,
+        .height = PX_HEIGHT,
+        .wall_hash = get_wall_hash(mask),
+        .radius = (u32)pvs->radius,
+        .run_count = pvs->run_count,
+    };
+    if ((fwrite(&header, sizeof(PvsHeader), 1, file) != 1) ||
+        (fwrite(pvs->offsets, sizeof(u32[PVS_CELLS + 1]), 1, file) != 1) ||
+        (fwrite(pvs->runs, sizeof(u16), pvs->run_count, file) !=
+         pvs->run_count))
+    {
+        ERROR("fwrite(...)");
+    }
+    fclose(file);
+}
+
+// NOTE: Every cell's runs have to sit inside `runs` and cover at most
+// `PVS_CELLS` bits, otherwise decoding would write past the end of a set.
+static Bool get_pvs_valid(const Pvs* pvs) {
+    if (pvs->offsets[0] != 0) {
+        return FALSE;
+    }
+    for (u16 k = 0; k < PVS_CELLS; ++k) {
+        const u32 start = pvs->offsets[k];
+        const u32 end = pvs->offsets[k + 1];
+        if ((end < start) || (pvs->run_count < end)) {
+            return FALSE;
+        }
+        u32 length = 0;
+        for (u32 i = start; i < end; ++i) {
+            length += pvs->runs[i];
+        }
+        if (PVS_CELLS < length) {
+            return FALSE;
+        }
+    }
+    return pvs->offsets[PVS_CELLS] == pvs->run_count ? TRUE : FALSE;
+}
+
+// NOTE: Returns `FALSE` (leaving `permanent` as it was) if the file is
+// missing, short, corrupt, or was built for a different map, so the caller
+// can rebuild.
+static Bool load_pvs(Pvs*        pvs,
+                     Arena*      permanent,
+                     u8          mask[PX_HEIGHT][PX_WIDTH],
+                     i16         radius,
+                     const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return FALSE;
+    }
+    PvsHeader header;
+    if ((fread(&header, sizeof(PvsHeader), 1, file) != 1) ||
+        (header.magic != PVS_MAGIC) || (header.width != PX_WIDTH) ||
+        (header.height != PX_HEIGHT) ||
+        (header.wall_hash != get_wall_hash(mask)) ||
+        (header.radius != (u32)radius) ||
+        (((usize)PVS_CELLS * (PVS_CELLS + 1)) < header.run_count) ||
+        ((permanent->cap - permanent->used) <
+         ((2 * ARENA_ALIGN) + sizeof(u32[PVS_CELLS + 1]) +
+          (sizeof(u16) * header.run_count))))
+    {
+        fclose(file);
+        return FALSE;
+    }
+    const usize used = permanent->used;
+    pvs->radius = radius;
+    alloc_pvs_tables(pvs, permanent, header.run_count);
+    if ((fread(pvs->offsets, sizeof(u32[PVS_CELLS + 1]), 1, file) != 1) ||
+        (fread(pvs->runs, sizeof(u16), pvs->run_count, file) !=
+         pvs->run_count) ||
+        (fgetc(file) != EOF) || (!get_pvs_valid(pvs)))
+    {
+        fclose(file);
+        permanent->used = used;
+        return FALSE;
+    }
+    fclose(file);
+    set_pvs_cache_cap(pvs, PVS_CACHE_DEFAULT);
+    return TRUE;
+}
+
+// NOTE: Like `set_mask_bounds`, only cells inside `bounds` are cleared and
+// set, so the cost follows the size of `bounds` rather than the map; each row
+// of `bounds` only touches the words it overlaps.
+static void set_mask_pvs(u8            mask[PX_HEIGHT][PX_WIDTH],
+                         Pvs*          pvs,
+                         i16           x,
+                         i16           y,
+                         const Bounds* bounds) {
+    reset_mask_bounds(mask, NULL, bounds);
+    mask[y][x] &= MASK_PLAYER;
+    u64 bits[PVS_WORDS];
+    if (get_pvs_bits(pvs, (u32)((y * PX_WIDTH) + x), bits)) {
+        ++pvs->hits;
+    } else {
+        ++pvs->misses;
+    }
+    for (i16 i = bounds->y0; i < bounds->y1; ++i) {
+        const u16 start = (u16)((i * PX_WIDTH) + bounds->x0);
+        const u16 end = (u16)((i * PX_WIDTH) + bounds->x1);
+        for (u16 w = start / 64; w <= (end - 1) / 64; ++w) {
+            const u16 low = start < (w * 64) ? 0 : (u16)(start - (w * 64));
+            const u16 high = ((w + 1) * 64) < end ? 64 : (u16)(end - (w * 64));
+            const u64 range = (high == 64 ? ~0ull : ((1ull << high) - 1)) &
+                              ~((1ull << low) - 1);
+            for (u64 word = bits[w] & range; word; word &= word - 1) {
+                const u16 k = (u16)((w * 64) + __builtin_ctzll(word));
+                mask[k / PX_WIDTH][k % PX_WIDTH] |= MASK_PLAYER;
+            }
+        }
+    }
+}
+
+#endif
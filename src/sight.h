@@ -0,0 +1,366 @@
+#ifndef __SIGHT_H__
+#define __SIGHT_H__
+
+#include "arena.h"
+#include "geom.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+// NOTE: Answers "can `source` see `target`?" for a batch of queries, with
+// exactly the visibility `set_mask` would give. Queries are bucketed by
+// source; a source with several targets pays for one full shadowcast, while
+// a lone query only casts the octant(s) containing its target, and only out
+// to the target's row. Sources are spread across a pool of worker threads,
+// each with its own copy of the mask; the pool is started once and woken per
+// batch, so a batch never pays for creating threads.
+#define SIGHT_CELLS               (PX_WIDTH * PX_HEIGHT)
+#define SIGHT_THREADS_CAP         8
+#define SIGHT_THREADS_MIN_SOURCES 64
+
+typedef struct {
+    u8 source_x;
+    u8 source_y;
+    u8 target_x;
+    u8 target_y;
+} SightQuery;
+
+typedef struct {
+    const SightQuery* queries;
+    Bool*             results;
+    const u32*        offsets;
+    const u32*        order;
+    const u16*        sources;
+    u8 (*masks)[PX_HEIGHT][PX_WIDTH];
+    u32 source_count;
+    u32 next;
+    i16 radius;
+} Sight;
+
+typedef struct SightPool SightPool;
+
+typedef struct {
+    SightPool* pool;
+    u8         index;
+} SightWorker;
+
+// NOTE: The calling thread works as worker 0, so the pool only starts
+// `thread_count - 1` threads. Each batch bumps `generation`; every pool
+// thread wakes, helps if its index is below `active`, and checks back in
+// through `running`.
+struct SightPool {
+    pthread_t       threads[SIGHT_THREADS_CAP];
+    SightWorker     workers[SIGHT_THREADS_CAP];
+    pthread_mutex_t mutex;
+    pthread_cond_t  start;
+    pthread_cond_t  done;
+    Sight*          sight;
+    u32             generation;
+    u8              thread_count;
+    u8              active;
+    u8              running;
+    Bool            stop;
+};
+
+static void set_mask_octal(u8    mask[PX_HEIGHT][PX_WIDTH],
+                           Octal octal,
+                           Bool  col_row) {
+    if (col_row) {
+        set_mask_col_row(mask, NULL, octal);
+    } else {
+        set_mask_row_col(mask, NULL, octal);
+    }
+}
+
+static Bool get_sight_single(u8                mask[PX_HEIGHT][PX_WIDTH],
+                             const SightQuery* query,
+                             i16               radius) {
+    const i16 x_delta = (i16)(query->target_x - query->source_x);
+    const i16 y_delta = (i16)(query->target_y - query->source_y);
+    const i16 x_abs = (i16)(x_delta < 0 ? -x_delta : x_delta);
+    const i16 y_abs = (i16)(y_delta < 0 ? -y_delta : y_delta);
+    // NOTE: `radius` here only bounds the rows walked; the distance cut-off
+    // still comes from `radius_squared`.
+    Octal octal = {
+        .slope_start = 1.0f,
+        .slope_end = 0.0f,
+        .x = query->source_x,
+        .y = query->source_y,
+        .loop_start = 1,
+        .radius = x_abs < y_abs ? y_abs : x_abs,
+        .radius_squared = (i16)(radius * radius),
+        .mask = MASK_PLAYER,
+    };
+    if (radius < octal.radius) {
+        return FALSE;
+    }
+    reset_mask(mask);
+    // NOTE: A target on an axis (or diagonal) is reachable from both of the
+    // quadrants (or octants) sharing it, and `set_mask` lights it if either
+    // one does.
+    for (i8 x_sign = -1; x_sign <= 1; x_sign = (i8)(x_sign + 2)) {
+        if ((x_delta * x_sign) < 0) {
+            continue;
+        }
+        for (i8 y_sign = -1; y_sign <= 1; y_sign = (i8)(y_sign + 2)) {
+            if ((y_delta * y_sign) < 0) {
+                continue;
+            }
+            octal.x_sign = x_sign;
+            octal.y_sign = y_sign;
+            if (x_abs <= y_abs) {
+                set_mask_octal(mask, octal, TRUE);
+            }
+            if (y_abs <= x_abs) {
+                set_mask_octal(mask, octal, FALSE);
+            }
+        }
+    }
+    return mask[query->target_y][query->target_x] & MASK_PLAYER ? TRUE
+                                                                 : FALSE;
+}
+
+static void set_sight_source(Sight* sight, u32 source, u8 index) {
+    u8(*mask)[PX_WIDTH] = sight->masks[index];
+    const u16 cell = sight->sources[source];
+    const u32 start = sight->offsets[cell];
+    const u32 end = sight->offsets[cell + 1];
+    const i16 x = (i16)(cell % PX_WIDTH);
+    const i16 y = (i16)(cell / PX_WIDTH);
+    if ((end - start) == 1) {
+        const u32         i = sight->order[start];
+        const SightQuery* query = &sight->queries[i];
+        sight->results[i] = ((query->source_x == query->target_x) &&
+                             (query->source_y == query->target_y))
+                                ? TRUE
+                                : get_sight_single(mask, query, sight->radius);
+        return;
+    }
+    // NOTE: `set_mask` clears the source cell, which would otherwise erase a
+    // wall there for every later source on this thread.
+    const u8 origin = mask[y][x];
+    set_mask(mask, NULL, x, y, sight->radius);
+    mask[y][x] = origin;
+    for (u32 j = start; j < end; ++j) {
+        const u32         i = sight->order[j];
+        const SightQuery* query = &sight->queries[i];
+        sight->results[i] = ((query->source_x == query->target_x) &&
+                             (query->source_y == query->target_y)) ||
+                                    (mask[query->target_y][query->target_x] &
+                                     MASK_PLAYER)
+                                ? TRUE
+                                : FALSE;
+    }
+}
+
+static void run_sight(Sight* sight, u8 index) {
+    for (;;) {
+        const u32 source =
+            __atomic_fetch_add(&sight->next, 1, __ATOMIC_RELAXED);
+        if (sight->source_count <= source) {
+            return;
+        }
+        set_sight_source(sight, source, index);
+    }
+}
+
+static void* sight_thread(void* argument) {
+    SightWorker* worker = (SightWorker*)argument;
+    SightPool*   pool = worker->pool;
+    u32          generation = 0;
+    for (;;) {
+        pthread_mutex_lock(&pool->mutex);
+        while ((pool->generation == generation) && (!pool->stop)) {
+            pthread_cond_wait(&pool->start, &pool->mutex);
+        }
+        if (pool->stop) {
+            pthread_mutex_unlock(&pool->mutex);
+            return NULL;
+        }
+        generation = pool->generation;
+        Sight*   sight = pool->sight;
+        const u8 active = pool->active;
+        pthread_mutex_unlock(&pool->mutex);
+        if (worker->index < active) {
+            run_sight(sight, worker->index);
+        }
+        pthread_mutex_lock(&pool->mutex);
+        if (--pool->running == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+        pthread_mutex_unlock(&pool->mutex);
+    }
+}
+
+static u8 get_sight_thread_count(void) {
+    const long online = sysconf(_SC_NPROCESSORS_ONLN);
+    if (online < 1) {
+        return 1;
+    }
+    return online < SIGHT_THREADS_CAP ? (u8)online : SIGHT_THREADS_CAP;
+}
+
+static void init_sight_pool(SightPool* pool) {
+    pool->thread_count = get_sight_thread_count();
+    pool->sight = NULL;
+    pool->generation = 0;
+    pool->active = 0;
+    pool->running = 0;
+    pool->stop = FALSE;
+    if (pthread_mutex_init(&pool->mutex, NULL) ||
+        pthread_cond_init(&pool->start, NULL) ||
+        pthread_cond_init(&pool->done, NULL))
+    {
+        ERROR("pthread_*_init(...)");
+    }
+    for (u8 i = 1; i < pool->thread_count; ++i) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+        if (pthread_create(&pool->threads[i],
+                           NULL,
+                           sight_thread,
+                           &pool->workers[i]))
+        {
+            ERROR("pthread_create(...)");
+        }
+    }
+}
+
+static void free_sight_pool(SightPool* pool) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->stop = TRUE;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->mutex);
+    for (u8 i = 1; i < pool->thread_count; ++i) {
+        if (pthread_join(pool->threads[i], NULL)) {
+            ERROR("pthread_join(...)");
+        }
+    }
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->mutex);
+}
+
+// NOTE: The most scratch `query_sight` takes for a batch of `count` queries.
+static usize get_sight_scratch_size(u32 count) {
+    return (4 * ARENA_ALIGN) + sizeof(u32[SIGHT_CELLS + 1]) +
+           (sizeof(u32) * count) + sizeof(u16[SIGHT_CELLS]) +
+           sizeof(u8[SIGHT_THREADS_CAP][PX_HEIGHT][PX_WIDTH]);
+}
+
+// NOTE: Only `MASK_WALL` bits of `mask` are read. `results[i]` answers
+// `queries[i]`; a cell always sees itself. Up to
+// `get_sight_scratch_size(count)` bytes come from `scratch`, which the caller
+// resets.
+static void query_sight(SightPool*        pool,
+                        u8                mask[PX_HEIGHT][PX_WIDTH],
+                        const SightQuery* queries,
+                        u32               count,
+                        i16               radius,
+                        Bool*             results,
+                        Arena*            scratch) {
+    u32* offsets = alloc_arena(scratch, sizeof(u32[SIGHT_CELLS + 1]));
+    u32* order = alloc_arena(scratch, sizeof(u32) * count);
+    memset(offsets, 0, sizeof(u32[SIGHT_CELLS + 1]));
+    for (u32 i = 0; i < count; ++i) {
+        const SightQuery* query = &queries[i];
+        if ((PX_WIDTH <= query->source_x) || (PX_HEIGHT <= query->source_y) ||
+            (PX_WIDTH <= query->target_x) || (PX_HEIGHT <= query->target_y))
+        {
+            ERROR("query out of bounds");
+        }
+        ++offsets[(query->source_y * PX_WIDTH) + query->source_x + 1];
+    }
+    u32 source_count = 0;
+    for (u16 k = 0; k < SIGHT_CELLS; ++k) {
+        if (offsets[k + 1]) {
+            ++source_count;
+        }
+        offsets[k + 1] += offsets[k];
+    }
+    u16* sources = alloc_arena(scratch, sizeof(u16) * source_count);
+    source_count = 0;
+    for (u16 k = 0; k < SIGHT_CELLS; ++k) {
+        if (offsets[k] != offsets[k + 1]) {
+            sources[source_count++] = k;
+        }
+    }
+    {
+        // NOTE: Bucket queries by source cell; `offsets` is rebuilt as we go
+        // and ends up where it started.
+        for (u32 i = 0; i < count; ++i) {
+            const SightQuery* query = &queries[i];
+            const u16         cell =
+                (u16)((query->source_y * PX_WIDTH) + query->source_x);
+            order[offsets[cell]++] = i;
+        }
+        for (u16 k = SIGHT_CELLS; 0 < k; --k) {
+            offsets[k] = offsets[k - 1];
+        }
+        offsets[0] = 0;
+    }
+    const u8 active =
+        source_count < SIGHT_THREADS_MIN_SOURCES ? 1 : pool->thread_count;
+    Sight sight = {
+        .queries = queries,
+        .results = results,
+        .offsets = offsets,
+        .order = order,
+        .sources = sources,
+        .masks =
+            alloc_arena(scratch, sizeof(u8[PX_HEIGHT][PX_WIDTH]) * active),
+        .source_count = source_count,
+        .next = 0,
+        .radius = radius,
+    };
+    for (u8 i = 0; i < active; ++i) {
+        memcpy(sight.masks[i], mask, sizeof(u8[PX_HEIGHT][PX_WIDTH]));
+    }
+    if (active == 1) {
+        run_sight(&sight, 0);
+        return;
+    }
+    pthread_mutex_lock(&pool->mutex);
+    pool->sight = &sight;
+    pool->active = active;
+    pool->running = (u8)(pool->thread_count - 1);
+    ++pool->generation;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->mutex);
+    run_sight(&sight, 0);
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->running) {
+        pthread_cond_wait(&pool->done, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+// NOTE: Checks every answer against a full `set_mask` from its source and
+// returns how many targets were visible.
+static u32 check_sight(u8                mask[PX_HEIGHT][PX_WIDTH],
+                       const SightQuery* queries,
+                       u32               count,
+                       i16               radius,
+                       const Bool*       results) {
+    u32 visible = 0;
+    for (u32 i = 0; i < count; ++i) {
+        const SightQuery* query = &queries[i];
+        const u8          origin = mask[query->source_y][query->source_x];
+        set_mask(mask, NULL, query->source_x, query->source_y, radius);
+        mask[query->source_y][query->source_x] = origin;
+        const Bool expected =
+            ((query->source_x == query->target_x) &&
+             (query->source_y == query->target_y)) ||
+                    (mask[query->target_y][query->target_x] & MASK_PLAYER)
+                ? TRUE
+                : FALSE;
+        if (results[i] != expected) {
+            ERROR("results[i] != expected");
+        }
+        visible += results[i];
+    }
+    reset_mask(mask);
+    return visible;
+}
+
+#endif